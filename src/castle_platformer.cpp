@@ -10,6 +10,8 @@
 #include <cmath>
 #include "util.h"
 #include "player.h"
+#include "render_scale.h"
+#include "game_state.h"
 #include <nlohmann/json.hpp>
 
 using namespace util;
@@ -36,7 +38,6 @@ using namespace util;
 // * Make menu buttons the same regardless of window size
 // * Make pixel art always correspond to game size
 //   * Or some fraction of game size that can be scaled up in various ways
-// * Add setting to "snap" game resolution to the biggest perfect multiple
 // * Move Texture into Drawable
 // * Move rendering into a class so that camera position and renderer don't need to be passed in
 
@@ -141,6 +142,10 @@ int SCREEN_H = 720;
 int SCREEN_PADDING_X = 0;
 int SCREEN_PADDING_Y = 0;
 
+// Size of the offscreen render target, which is upscaled into the screen area
+int RENDER_W = 1280;
+int RENDER_H = 720;
+
 const int SCREEN_RATIO_W = 16;
 const int SCREEN_RATIO_H = 9;
 
@@ -170,34 +175,36 @@ const double CAMERA_BOUND_RIGHT = STAGE_BOUND_RIGHT - GAME_BOX_W / 2;
 const double CAMERA_BOUND_BOTTOM = STAGE_BOUND_BOTTOM + GAME_BOX_H / 2;
 const double CAMERA_BOUND_TOP = STAGE_BOUND_TOP - GAME_BOX_H / 2;
 
-// Conversion from Game to Screen position
-double GAME_TO_SCREEN_MULTIPLIER = (double)SCREEN_W / GAME_BOX_W;
+// Conversion from Game to Render target position
+double GAME_TO_RENDER_MULTIPLIER = (double)RENDER_W / GAME_BOX_W;
+// Conversion from Screen to Render target size
+double SCREEN_TO_RENDER_MULTIPLIER = (double)RENDER_W / SCREEN_W;
 
 // Other
 const double BG_SCROLL_SPEED = -0.22;
 
-int TransformGameXToWindowX(double game_x)
+int TransformGameXToRenderX(double game_x)
 {
-    return std::round((game_x * GAME_TO_SCREEN_MULTIPLIER) + (SCREEN_W / 2));
+    return std::round((game_x * GAME_TO_RENDER_MULTIPLIER) + (RENDER_W / 2));
 }
 
-int TransformGameYToWindowY(double game_y)
+int TransformGameYToRenderY(double game_y)
 {
-    return std::round((-game_y) * GAME_TO_SCREEN_MULTIPLIER) + (SCREEN_H / 2);
+    return std::round((-game_y) * GAME_TO_RENDER_MULTIPLIER) + (RENDER_H / 2);
 }
 
 void DrawAtPosition(Point camera_center, Drawable &drawable)
 {
     // TODO: Possible optimization, don't recalculate height/width every time
     // (Cache it for each sprite until window size changes)
-    int left_position = TransformGameXToWindowX(drawable.game_rect.x - camera_center.x);
-    int right_position = TransformGameXToWindowX(drawable.game_rect.x + drawable.game_rect.w - camera_center.x);
-    drawable.draw_rect.x = left_position + SCREEN_PADDING_X;
+    int left_position = TransformGameXToRenderX(drawable.game_rect.x - camera_center.x);
+    int right_position = TransformGameXToRenderX(drawable.game_rect.x + drawable.game_rect.w - camera_center.x);
+    drawable.draw_rect.x = left_position;
     drawable.draw_rect.w = right_position - left_position;
 
-    int bottom_position = TransformGameYToWindowY(drawable.game_rect.y - camera_center.y);
-    int top_position = TransformGameYToWindowY(drawable.game_rect.y + drawable.game_rect.h - camera_center.y);
-    drawable.draw_rect.y = top_position + SCREEN_PADDING_Y;
+    int bottom_position = TransformGameYToRenderY(drawable.game_rect.y - camera_center.y);
+    int top_position = TransformGameYToRenderY(drawable.game_rect.y + drawable.game_rect.h - camera_center.y);
+    drawable.draw_rect.y = top_position;
     drawable.draw_rect.h = bottom_position - top_position;
 }
 
@@ -206,14 +213,14 @@ void DrawAtPosition(Point camera_center, Drawable &drawable)
  */
 void DrawAtPositionStatic(Drawable &drawable)
 {
-    int left_position = TransformGameXToWindowX(drawable.game_rect.x);
-    int right_position = TransformGameXToWindowX(drawable.game_rect.x + drawable.game_rect.w);
-    drawable.draw_rect.x = left_position + SCREEN_PADDING_X;
+    int left_position = TransformGameXToRenderX(drawable.game_rect.x);
+    int right_position = TransformGameXToRenderX(drawable.game_rect.x + drawable.game_rect.w);
+    drawable.draw_rect.x = left_position;
     drawable.draw_rect.w = right_position - left_position;
 
-    int bottom_position = TransformGameYToWindowY(drawable.game_rect.y);
-    int top_position = TransformGameYToWindowY(drawable.game_rect.y + drawable.game_rect.h);
-    drawable.draw_rect.y = top_position + SCREEN_PADDING_Y;
+    int bottom_position = TransformGameYToRenderY(drawable.game_rect.y);
+    int top_position = TransformGameYToRenderY(drawable.game_rect.y + drawable.game_rect.h);
+    drawable.draw_rect.y = top_position;
     drawable.draw_rect.h = bottom_position - top_position;
 }
 
@@ -223,7 +230,10 @@ void RenderAtPosition(SDL_Renderer *renderer, Point camera_center, Drawable &dra
     if (drawable.is_repeating_texture)
     {
         // TODO: Remove hardcoded *4
-        RenderRepeatedTexture(renderer, drawable.texture, drawable.texture.w * 4, drawable.texture.h * 4, drawable.draw_rect);
+        // Tiles keep their on-screen size regardless of the render target's resolution
+        int tile_w = std::max(1, (int)std::round(drawable.texture.w * 4 * SCREEN_TO_RENDER_MULTIPLIER));
+        int tile_h = std::max(1, (int)std::round(drawable.texture.h * 4 * SCREEN_TO_RENDER_MULTIPLIER));
+        RenderRepeatedTexture(renderer, drawable.texture, tile_w, tile_h, drawable.draw_rect);
     }
     else
     {
@@ -240,14 +250,201 @@ void RenderAtPositionStatic(SDL_Renderer *renderer, Drawable &drawable)
 void RenderFullScreenRect(SDL_Renderer *renderer)
 {
     SDL_Rect full_screen_rect = {
-        x : SCREEN_PADDING_X,
-        y : SCREEN_PADDING_Y,
-        w : SCREEN_W,
-        h : SCREEN_H
+        x : 0,
+        y : 0,
+        w : RENDER_W,
+        h : RENDER_H
     };
     SDL_RenderFillRect(renderer, &full_screen_rect);
 }
 
+/**
+ * (Re)creates the offscreen texture that the game is drawn into, sized
+ * RENDER_W by RENDER_H. Smooth targets are upscaled with linear filtering,
+ * otherwise nearest-neighbour is used so integer scales stay pixel-perfect.
+ */
+SDL_Texture *CreateRenderTarget(SDL_Renderer *renderer, SDL_Texture *old_target, bool smooth)
+{
+    if (old_target != NULL)
+    {
+        SDL_DestroyTexture(old_target);
+    }
+
+    SDL_Texture *new_target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, RENDER_W, RENDER_H);
+    if (new_target == NULL)
+    {
+        printf("Unable to create %dx%d render target! SDL Error: %s\n", RENDER_W, RENDER_H, SDL_GetError());
+    }
+    else
+    {
+        SDL_SetTextureScaleMode(new_target, smooth ? SDL_ScaleModeLinear : SDL_ScaleModeNearest);
+    }
+
+    return new_target;
+}
+
+/**
+ * Runs the gameplay part of a single tick. Depends only on its arguments so
+ * that recorded ticks can be replayed exactly.
+ */
+void StepGame(GameState &state, TickInput input, const Player &player, const std::list<Drawable> &terrains)
+{
+    state.frame_number++;
+    if (input.toggle_pause)
+    {
+        state.paused = !state.paused;
+    }
+    if (!state.paused)
+    {
+        PlayerState &player_state = state.player;
+        if (input.up)
+        {
+            if (player_state.is_grounded)
+            {
+                player_state.y_velocity = 13.0 + 0.6;
+                player_state.is_grounded = false;
+            }
+        }
+        if (input.right)
+        {
+            player_state.game_rect.x += 3.5;
+            for (const Drawable &drawableTerrain : terrains)
+            {
+                if (Collides(player_state.game_rect, drawableTerrain.game_rect))
+                {
+                    player_state.game_rect.x = drawableTerrain.game_rect.x - player_state.game_rect.w;
+                    break;
+                }
+            }
+            player_state.flip = SDL_FLIP_NONE;
+        }
+        if (input.left)
+        {
+            player_state.game_rect.x -= 3.5;
+            for (const Drawable &drawableTerrain : terrains)
+            {
+                if (Collides(player_state.game_rect, drawableTerrain.game_rect))
+                {
+                    player_state.game_rect.x = drawableTerrain.game_rect.x + drawableTerrain.game_rect.w;
+                    break;
+                }
+            }
+            player_state.flip = SDL_FLIP_HORIZONTAL;
+        }
+
+        player_state.y_velocity -= 0.6;
+        player_state.y_velocity = std::max(player_state.y_velocity, player.max_fall_speed);
+        player_state.game_rect.y += player_state.y_velocity;
+        player_state.is_grounded = false;
+        for (const Drawable &drawableTerrain : terrains)
+        {
+            if (Collides(player_state.game_rect, drawableTerrain.game_rect))
+            {
+                if (player_state.y_velocity < 0)
+                {
+                    player_state.game_rect.y = drawableTerrain.game_rect.y + drawableTerrain.game_rect.h;
+                    player_state.y_velocity = 0;
+                    player_state.is_grounded = true;
+                    break;
+                }
+                else
+                {
+                    player_state.game_rect.y = drawableTerrain.game_rect.y - player_state.game_rect.h;
+                    player_state.y_velocity = 0;
+                    break;
+                }
+            }
+        }
+
+        state.cloud_x -= .35;
+        if (state.cloud_x < GAME_BOX_BOUND_LEFT)
+        {
+            state.cloud_x += GAME_BOX_W;
+        }
+    }
+
+    state.camera_center.x = std::clamp(state.player.game_rect.x + (state.player.game_rect.w / 2.0), CAMERA_BOUND_LEFT, CAMERA_BOUND_RIGHT);
+    state.camera_center.y = std::clamp(state.player.game_rect.y + CAMERA_CENTER_VERTICAL_OFFSET, CAMERA_BOUND_BOTTOM, CAMERA_BOUND_TOP);
+}
+
+/**
+ * Replays `tick_count` recorded ticks on top of a state taken from the
+ * RewindBuffer, leaving it where the live game was after the last of them
+ */
+void ResimulateTicks(GameState &state, const TickInput *inputs, int tick_count, const Player &player, const std::list<Drawable> &terrains)
+{
+    for (int tick = 0; tick < tick_count; tick++)
+    {
+        StepGame(state, inputs[tick], player, terrains);
+    }
+}
+
+/**
+ * Logs how long snapshotting, restoring, the rewind buffer, and resimulation
+ * take. Works on copies, so the running game is not affected.
+ */
+void BenchmarkRewind(const GameState &state, const RewindBuffer &rewind_buffer, const Player &player, const std::list<Drawable> &terrains)
+{
+    const int COPY_ITERATIONS = 100000;
+    const int RESIMULATE_TICKS = 60;
+
+    // Written through volatile pointers so the copies are not optimized away
+    GameState snapshot;
+    GameState *volatile snapshot_target = &snapshot;
+    auto start_time = std::chrono::steady_clock::now();
+    for (int i = 0; i < COPY_ITERATIONS; i++)
+    {
+        *snapshot_target = state;
+    }
+    std::chrono::duration<double, std::nano> snapshot_time = std::chrono::steady_clock::now() - start_time;
+
+    GameState restored = state;
+    GameState *volatile restore_target = &restored;
+    start_time = std::chrono::steady_clock::now();
+    for (int i = 0; i < COPY_ITERATIONS; i++)
+    {
+        *restore_target = snapshot;
+    }
+    std::chrono::duration<double, std::nano> restore_time = std::chrono::steady_clock::now() - start_time;
+
+    prettyLog("Snapshot ns:", snapshot_time.count() / COPY_ITERATIONS, "restore ns:", restore_time.count() / COPY_ITERATIONS,
+              "state bytes:", sizeof(GameState));
+
+    int tick_count = rewind_buffer.Size();
+    if (tick_count == 0)
+    {
+        return;
+    }
+
+    RewindBuffer scratch_buffer = rewind_buffer;
+    std::vector<GameState> popped_states(tick_count);
+    start_time = std::chrono::steady_clock::now();
+    for (int i = 0; i < tick_count; i++)
+    {
+        scratch_buffer.Pop(popped_states[i]);
+    }
+    std::chrono::duration<double, std::nano> pop_time = std::chrono::steady_clock::now() - start_time;
+
+    start_time = std::chrono::steady_clock::now();
+    for (int i = tick_count - 1; i >= 0; i--)
+    {
+        scratch_buffer.Push(popped_states[i], {});
+    }
+    std::chrono::duration<double, std::nano> push_time = std::chrono::steady_clock::now() - start_time;
+
+    prettyLog("Rewind buffer ticks:", tick_count, "push ns:", push_time.count() / tick_count, "pop ns:", pop_time.count() / tick_count);
+
+    int resimulate_ticks = std::min(RESIMULATE_TICKS, tick_count);
+    GameState resimulated;
+    std::vector<TickInput> inputs(resimulate_ticks);
+    start_time = std::chrono::steady_clock::now();
+    rewind_buffer.Peek(resimulate_ticks, resimulated, inputs.data());
+    ResimulateTicks(resimulated, inputs.data(), resimulate_ticks, player, terrains);
+    std::chrono::duration<double, std::micro> resimulate_time = std::chrono::steady_clock::now() - start_time;
+
+    prettyLog("Resimulate", resimulate_ticks, "ticks us:", resimulate_time.count(), "matches live state:", StatesEqual(resimulated, state));
+}
+
 enum class ScreenMode
 {
     FIT,
@@ -261,7 +458,7 @@ int main(int argc, char **argv)
     std::string project_dir_path = build_dir_path.substr(0, build_dir_path.find_last_of("\\"));
 
     SDL_Window *window = SDL_CreateWindow("Castle Platformer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_W, SCREEN_H, SDL_WINDOW_RESIZABLE);
-    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, 0);
+    SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_TARGETTEXTURE);
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
     SizedTexture text_start = LoadSizedTexture(project_dir_path + "/assets/text_start.png", renderer);
@@ -282,10 +479,10 @@ int main(int argc, char **argv)
 
     Player player;
     player.rects.texture = king_texture;
-    Point camera_center;
 
-    bool menu = true;
-    int menu_hovered_index = 0;
+    GameState state;
+    // ~90 bytes per tick at worst, so this holds at least 10 seconds at 60fps
+    RewindBuffer rewind_buffer(64 * 1024);
     const std::vector<SizedTexture> menu_buttons = {text_start, text_settings, text_exit};
     std::vector<Drawable> menu_buttons_text = {
         {game_rect : {x : -200, y : -48, w : 400, h : 96}, texture : text_start},
@@ -312,15 +509,14 @@ int main(int argc, char **argv)
     Drawable bg_left = {{x : -GAME_BOX_W, y : GAME_BOX_BOUND_BOTTOM, w : GAME_BOX_W, h : GAME_BOX_H}, texture : bg_texture};
     Drawable bg_right = {{x : 0, y : GAME_BOX_BOUND_BOTTOM, w : GAME_BOX_W, h : GAME_BOX_H}, texture : bg_texture};
 
-    bool paused = false;
     Drawable paused_text = {{x : -188, y : -32, w : 376, h : 64}, texture : paused_texture};
 
-    double cloud_x = 0.0;
     Drawable clouds_left = {{x : -GAME_BOX_W, y : GAME_BOX_BOUND_BOTTOM, w : GAME_BOX_W, h : GAME_BOX_H}, texture : clouds_texture};
     Drawable clouds_right = {{x : 0, y : GAME_BOX_BOUND_BOTTOM, w : GAME_BOX_W, h : GAME_BOX_H}, texture : clouds_texture};
 
     Drawable moon = {{x : 480, y : 253, w : 67, h : 67}, texture : moon_texture};
 
+    SDL_Rect screen_area = {};
     SDL_Rect screen_bar_left = {};
     SDL_Rect screen_bar_right = {};
     SDL_Rect screen_bar_top = {};
@@ -337,12 +533,13 @@ int main(int argc, char **argv)
     std::unordered_set<SDL_KeyCode> keys_pressed;
 
     ScreenMode screen_mode = ScreenMode::FIT;
-    bool should_recalculate_screen = false;
+    bool should_recalculate_screen = true;
 
     auto frame_length = std::chrono::microseconds{(int)(1.0 / 60.0 * 1000.0 * 1000.0)};
-    auto current_time = std::chrono::steady_clock::now();
 
-    int frame_number = 0;
+    RenderScaler render_scaler(frame_length.count() / 1000.0);
+    SDL_Texture *render_target = NULL;
+    auto current_time = std::chrono::steady_clock::now();
 
     while (isRunning)
     {
@@ -401,24 +598,55 @@ int main(int argc, char **argv)
                 }
             }
 
-            // Recalculate anything depending on SCREEN_W or SCREEN_H
-            GAME_TO_SCREEN_MULTIPLIER = (double)SCREEN_W / GAME_BOX_W;
+            if (render_scaler.mode == RenderScaleMode::SNAP)
+            { // Shrink the screen area to an exact multiple of the render target
+                RENDER_W = SCREEN_W / render_scaler.snap_divisor;
+                RENDER_H = SCREEN_H / render_scaler.snap_divisor;
+                SCREEN_W = RENDER_W * render_scaler.snap_divisor;
+                SCREEN_H = RENDER_H * render_scaler.snap_divisor;
+            }
+            else
+            {
+                RENDER_W = std::max(1, (int)std::round(SCREEN_W * render_scaler.Scale()));
+                RENDER_H = std::max(1, (int)std::round(SCREEN_H * render_scaler.Scale()));
+            }
+            if (RENDER_W < SCREEN_W)
+            {
+                render_target = CreateRenderTarget(renderer, render_target, render_scaler.mode == RenderScaleMode::AUTO);
+            }
+            else if (render_target != NULL)
+            { // At full scale, draw straight to the window instead
+                SDL_DestroyTexture(render_target);
+                render_target = NULL;
+            }
+            if (render_target == NULL)
+            {
+                RENDER_W = SCREEN_W;
+                RENDER_H = SCREEN_H;
+            }
+            prettyLog("Render target:", RENDER_W, "x", RENDER_H, "-> screen area:", SCREEN_W, "x", SCREEN_H);
+
+            // Recalculate anything depending on SCREEN_W, SCREEN_H, RENDER_W, or RENDER_H
+            GAME_TO_RENDER_MULTIPLIER = (double)RENDER_W / GAME_BOX_W;
+            SCREEN_TO_RENDER_MULTIPLIER = (double)RENDER_W / SCREEN_W;
 
             // Amount of padding per side when the aspect ratio is not perfect,
             // in order to center the game
             SCREEN_PADDING_X = (ACTUAL_SCREEN_W - SCREEN_W) / 2;
             SCREEN_PADDING_Y = (ACTUAL_SCREEN_H - SCREEN_H) / 2;
+            screen_area = {x : SCREEN_PADDING_X, y : SCREEN_PADDING_Y, w : SCREEN_W, h : SCREEN_H};
+            // The right/bottom bars also cover the leftover pixel when the padding is odd
             screen_bar_left = {x : 0, y : 0, w : SCREEN_PADDING_X, h : ACTUAL_SCREEN_H};
-            screen_bar_right = {x : ACTUAL_SCREEN_W - SCREEN_PADDING_X, y : 0, w : SCREEN_PADDING_X, h : ACTUAL_SCREEN_H};
+            screen_bar_right = {x : SCREEN_PADDING_X + SCREEN_W, y : 0, w : ACTUAL_SCREEN_W - SCREEN_PADDING_X - SCREEN_W, h : ACTUAL_SCREEN_H};
             screen_bar_top = {x : 0, y : 0, w : ACTUAL_SCREEN_W, h : SCREEN_PADDING_Y};
-            screen_bar_bottom = {x : 0, y : ACTUAL_SCREEN_H - SCREEN_PADDING_Y, w : ACTUAL_SCREEN_W, h : SCREEN_PADDING_Y};
+            screen_bar_bottom = {x : 0, y : SCREEN_PADDING_Y + SCREEN_H, w : ACTUAL_SCREEN_W, h : ACTUAL_SCREEN_H - SCREEN_PADDING_Y - SCREEN_H};
             should_recalculate_screen = false;
         }
 
         while (std::chrono::steady_clock::now() > current_time + frame_length)
         {
-            frame_number++;
             current_time += frame_length;
+            auto frame_start_time = std::chrono::steady_clock::now();
 
             if (newly_pressed_keys[SDL_SCANCODE_S])
             {
@@ -432,8 +660,22 @@ int main(int argc, char **argv)
                 }
                 should_recalculate_screen = true;
             }
+            if (newly_pressed_keys[SDL_SCANCODE_R])
+            {
+                render_scaler.NextMode();
+                should_recalculate_screen = true;
+            }
 
-            if (menu)
+            if (render_target != NULL)
+            {
+                SDL_SetRenderTarget(renderer, render_target);
+            }
+            else
+            { // Offset drawing into the screen area directly
+                SDL_RenderSetViewport(renderer, &screen_area);
+            }
+
+            if (state.menu)
             {
                 // TODO: Should only need to call RenderClear in one location
                 SDL_RenderClear(renderer);
@@ -448,22 +690,22 @@ int main(int argc, char **argv)
 
                 if (newly_pressed_keys[SDL_SCANCODE_DOWN])
                 {
-                    menu_hovered_index++;
-                    menu_hovered_index = PositiveModulo(menu_hovered_index, menu_buttons.size());
+                    state.menu_hovered_index++;
+                    state.menu_hovered_index = PositiveModulo(state.menu_hovered_index, menu_buttons.size());
                 }
                 if (newly_pressed_keys[SDL_SCANCODE_UP])
                 {
-                    menu_hovered_index--;
-                    menu_hovered_index = PositiveModulo(menu_hovered_index, menu_buttons.size());
+                    state.menu_hovered_index--;
+                    state.menu_hovered_index = PositiveModulo(state.menu_hovered_index, menu_buttons.size());
                 }
 
                 if (newly_pressed_keys[SDL_SCANCODE_Z] || newly_pressed_keys[SDL_SCANCODE_SPACE] || newly_pressed_keys[SDL_SCANCODE_RETURN])
                 {
-                    if (menu_hovered_index == MENU_START_INDEX)
+                    if (state.menu_hovered_index == MENU_START_INDEX)
                     {
-                        menu = false;
+                        state.menu = false;
                     }
-                    else if (menu_hovered_index == MENU_EXIT_INDEX)
+                    else if (state.menu_hovered_index == MENU_EXIT_INDEX)
                     {
                         SDL_Event quit_event = {type : SDL_QUIT};
                         SDL_PushEvent(&quit_event);
@@ -474,102 +716,49 @@ int main(int argc, char **argv)
                 {
                     Drawable current_button = menu_buttons_text.at(current_button_index);
                     menu_buttons_bg.game_rect = current_button.game_rect;
-                    menu_buttons_bg.texture = (current_button_index == menu_hovered_index) ? button_selected : button_unselected;
+                    menu_buttons_bg.texture = (current_button_index == state.menu_hovered_index) ? button_selected : button_unselected;
                     RenderAtPositionStatic(renderer, menu_buttons_bg);
                     RenderAtPositionStatic(renderer, current_button);
                 }
             }
             else
             {
+                TickInput input;
+                input.up = keyboard_state[SDL_SCANCODE_UP];
+                input.left = keyboard_state[SDL_SCANCODE_LEFT];
+                input.right = keyboard_state[SDL_SCANCODE_RIGHT];
+                input.toggle_pause = newly_pressed_keys[SDL_SCANCODE_P];
+
+                // Holding BACKSPACE steps backwards through recorded ticks instead of playing
+                if (!keyboard_state[SDL_SCANCODE_BACKSPACE] || !rewind_buffer.Pop(state))
+                {
+                    // Paused ticks change nothing, so they are neither recorded nor counted
+                    if (!state.paused || input.toggle_pause)
+                    {
+                        rewind_buffer.Push(state, input);
+                        StepGame(state, input, player, drawable_terrains);
+                    }
+                }
+
                 if (newly_pressed_keys[SDL_SCANCODE_ESCAPE])
                 {
-                    menu = true;
+                    state.menu = true;
                 }
-                if (newly_pressed_keys[SDL_SCANCODE_P])
+                if (!state.paused && keyboard_state[SDL_SCANCODE_I])
                 {
-                    paused = !paused;
+                    prettyLog("x:", state.player.game_rect.x, "y:", state.player.game_rect.y);
                 }
-                if (!paused)
+                if (newly_pressed_keys[SDL_SCANCODE_B])
                 {
-                    if (keyboard_state[SDL_SCANCODE_UP])
-                    {
-                        if (player.is_grounded)
-                        {
-                            player.y_velocity = 13.0 + 0.6;
-                            player.is_grounded = false;
-                        }
-                    }
-                    if (keyboard_state[SDL_SCANCODE_DOWN])
-                    {
-                    }
-                    if (keyboard_state[SDL_SCANCODE_RIGHT])
-                    {
-                        player.rects.game_rect.x += 3.5;
-                        for (Drawable &drawableTerrain : drawable_terrains)
-                        {
-                            if (Collides(player.rects.game_rect, drawableTerrain.game_rect))
-                            {
-                                player.rects.game_rect.x = drawableTerrain.game_rect.x - player.rects.game_rect.w;
-                                break;
-                            }
-                        }
-                        player.rects.flip = SDL_FLIP_NONE;
-                    }
-                    if (keyboard_state[SDL_SCANCODE_LEFT])
-                    {
-                        player.rects.game_rect.x -= 3.5;
-                        for (Drawable &drawableTerrain : drawable_terrains)
-                        {
-                            if (Collides(player.rects.game_rect, drawableTerrain.game_rect))
-                            {
-                                player.rects.game_rect.x = drawableTerrain.game_rect.x + drawableTerrain.game_rect.w;
-                                break;
-                            }
-                        }
-                        player.rects.flip = SDL_FLIP_HORIZONTAL;
-                    }
-                    if (keyboard_state[SDL_SCANCODE_I])
-                    {
-                        prettyLog("x:", player.rects.game_rect.x, "y:", player.rects.game_rect.y);
-                    }
-
-                    player.y_velocity -= 0.6;
-                    player.y_velocity = std::max(player.y_velocity, player.max_fall_speed);
-                    player.rects.game_rect.y += player.y_velocity;
-                    player.is_grounded = false;
-                    for (Drawable &drawableTerrain : drawable_terrains)
-                    {
-                        if (Collides(player.rects.game_rect, drawableTerrain.game_rect))
-                        {
-                            if (player.y_velocity < 0)
-                            {
-                                player.rects.game_rect.y = drawableTerrain.game_rect.y + drawableTerrain.game_rect.h;
-                                player.y_velocity = 0;
-                                player.is_grounded = true;
-                                break;
-                            }
-                            else
-                            {
-                                player.rects.game_rect.y = drawableTerrain.game_rect.y - player.rects.game_rect.h;
-                                player.y_velocity = 0;
-                                break;
-                            }
-                        }
-                    }
-
-                    cloud_x -= .35;
-                    if (cloud_x < GAME_BOX_BOUND_LEFT)
-                    {
-                        cloud_x += GAME_BOX_W;
-                    }
-                    clouds_left.game_rect.x = cloud_x - GAME_BOX_W;
-                    clouds_right.game_rect.x = cloud_x;
+                    BenchmarkRewind(state, rewind_buffer, player, drawable_terrains);
                 }
 
-                camera_center.x = std::clamp(player.rects.game_rect.x + (player.rects.game_rect.w / 2.0), CAMERA_BOUND_LEFT, CAMERA_BOUND_RIGHT);
-                camera_center.y = std::clamp(player.rects.game_rect.y + CAMERA_CENTER_VERTICAL_OFFSET, CAMERA_BOUND_BOTTOM, CAMERA_BOUND_TOP);
+                player.rects.game_rect = state.player.game_rect;
+                player.rects.flip = state.player.flip;
+                clouds_left.game_rect.x = state.cloud_x - GAME_BOX_W;
+                clouds_right.game_rect.x = state.cloud_x;
 
-                int bg_position = PositiveModulo((int)(BG_SCROLL_SPEED * camera_center.x) + (GAME_BOX_W / 2), GAME_BOX_W) - (GAME_BOX_W / 2);
+                int bg_position = PositiveModulo((int)(BG_SCROLL_SPEED * state.camera_center.x) + (GAME_BOX_W / 2), GAME_BOX_W) - (GAME_BOX_W / 2);
                 bg_right.game_rect.x = bg_position;
                 bg_left.game_rect.x = bg_position - GAME_BOX_W;
 
@@ -586,18 +775,25 @@ int main(int argc, char **argv)
 
                 for (Drawable &drawableTerrain : drawable_terrains)
                 {
-                    RenderAtPosition(renderer, camera_center, drawableTerrain);
+                    RenderAtPosition(renderer, state.camera_center, drawableTerrain);
                 }
 
-                RenderAtPosition(renderer, camera_center, player.rects);
+                RenderAtPosition(renderer, state.camera_center, player.rects);
 
-                if (paused)
+                if (state.paused)
                 {
                     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 120);
                     RenderFullScreenRect(renderer);
                     RenderAtPositionStatic(renderer, paused_text);
                 }
             }
+            SDL_SetRenderTarget(renderer, NULL);
+            SDL_RenderSetViewport(renderer, NULL);
+            if (render_target != NULL)
+            {
+                SDL_RenderCopy(renderer, render_target, NULL, &screen_area);
+            }
+
             SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
             SDL_RenderFillRect(renderer, &screen_bar_left);
             SDL_RenderFillRect(renderer, &screen_bar_right);
@@ -606,9 +802,16 @@ int main(int argc, char **argv)
 
             SDL_RenderPresent(renderer);
             std::fill(newly_pressed_keys, newly_pressed_keys + keyboard_size, 0);
+
+            std::chrono::duration<double, std::milli> frame_time = std::chrono::steady_clock::now() - frame_start_time;
+            if (render_scaler.RecordFrameTime(frame_time.count()))
+            {
+                should_recalculate_screen = true;
+            }
         }
     }
 
+    SDL_DestroyTexture(render_target);
     DestroyTextures();
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
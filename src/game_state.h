@@ -0,0 +1,262 @@
+#ifndef CASTLE_PLATFORMER_GAME_STATE
+#define CASTLE_PLATFORMER_GAME_STATE
+
+#include <algorithm>
+#include <bitset>
+#include <cassert>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "util.h"
+#include "player.h"
+
+/**
+ * Everything that changes while the game runs. Snapshotting or restoring it
+ * is a single struct copy.
+ */
+struct GameState
+{
+  PlayerState player;
+  util::Point camera_center = {0.0, 0.0};
+  double cloud_x = 0.0;
+  int frame_number = 0;
+  int menu_hovered_index = 0;
+  bool paused = false;
+  bool menu = true;
+};
+
+static_assert(std::is_trivially_copyable<GameState>::value, "GameState must stay trivially copyable");
+
+/**
+ * Field-by-field comparison; GameState's padding bytes are not meaningful
+ */
+inline bool StatesEqual(const GameState &a, const GameState &b)
+{
+  return a.player.game_rect.x == b.player.game_rect.x &&
+         a.player.game_rect.y == b.player.game_rect.y &&
+         a.player.game_rect.w == b.player.game_rect.w &&
+         a.player.game_rect.h == b.player.game_rect.h &&
+         a.player.y_velocity == b.player.y_velocity &&
+         a.player.flip == b.player.flip &&
+         a.player.is_grounded == b.player.is_grounded &&
+         a.camera_center.x == b.camera_center.x &&
+         a.camera_center.y == b.camera_center.y &&
+         a.cloud_x == b.cloud_x &&
+         a.frame_number == b.frame_number &&
+         a.menu_hovered_index == b.menu_hovered_index &&
+         a.paused == b.paused &&
+         a.menu == b.menu;
+}
+
+/**
+ * Player input for a single gameplay tick, enough to resimulate it
+ */
+struct TickInput
+{
+  bool up = false;
+  bool left = false;
+  bool right = false;
+  bool toggle_pause = false;
+};
+
+/**
+ * Keeps the most recent gameplay ticks within a fixed number of bytes.
+ *
+ * Each tick is stored as the XOR of its GameState against the previous
+ * tick's, split into 8-byte words, with only the words that changed written
+ * out. Only the newest state is kept in full; older states are rebuilt by
+ * undoing deltas from the newest one backwards, so the oldest tick can be
+ * dropped without needing a keyframe.
+ *
+ * Record layout: [word count: 1][changed words: 8 * count][input: 1][word mask: 4]
+ */
+class RewindBuffer
+{
+public:
+  static constexpr int WORD_COUNT = (sizeof(GameState) + sizeof(Uint64) - 1) / sizeof(Uint64);
+  static_assert(WORD_COUNT <= 32, "GameState is too big for a 32-bit word mask");
+
+  RewindBuffer(size_t capacity_bytes) : bytes(capacity_bytes)
+  {
+    assert(capacity_bytes >= RecordSize(WORD_COUNT) && "RewindBuffer must fit at least one full record");
+  }
+
+  int Size() const
+  {
+    return tick_count;
+  }
+
+  /**
+   * Records the state at the start of a tick and the input about to be applied to it
+   */
+  void Push(const GameState &state, TickInput input)
+  {
+    Uint64 words[WORD_COUNT] = {};
+    std::memcpy(words, &state, sizeof(GameState));
+
+    Uint64 changed_words[WORD_COUNT];
+    Uint32 mask = 0;
+    Uint8 count = 0;
+    for (int i = 0; i < WORD_COUNT; i++)
+    {
+      Uint64 diff = words[i] ^ latest_words[i];
+      if (diff != 0)
+      {
+        mask |= 1u << i;
+        changed_words[count++] = diff;
+      }
+    }
+
+    size_t record_size = RecordSize(count);
+    while (used + record_size > bytes.size() && tick_count > 0)
+    {
+      // Drop the oldest tick to make room
+      Uint8 oldest_count;
+      CopyOut(Wrap(head + bytes.size() - used), &oldest_count, 1);
+      used -= RecordSize(oldest_count);
+      tick_count--;
+    }
+
+    Uint8 packed_input = PackInput(input);
+    CopyIn(head, &count, 1);
+    CopyIn(Wrap(head + 1), changed_words, count * sizeof(Uint64));
+    CopyIn(Wrap(head + 1 + count * sizeof(Uint64)), &packed_input, 1);
+    CopyIn(Wrap(head + 2 + count * sizeof(Uint64)), &mask, sizeof(mask));
+    head = Wrap(head + record_size);
+    used += record_size;
+    tick_count++;
+
+    std::memcpy(latest_words, words, sizeof(words));
+  }
+
+  /**
+   * Restores the most recently pushed state and removes it from the buffer
+   */
+  bool Pop(GameState &state)
+  {
+    if (tick_count == 0)
+    {
+      return false;
+    }
+
+    std::memcpy(&state, latest_words, sizeof(GameState));
+    TickInput input;
+    size_t record_start = UndoRecord(head, latest_words, input);
+    used -= Wrap(head + bytes.size() - record_start);
+    head = record_start;
+    tick_count--;
+    return true;
+  }
+
+  /**
+   * Rebuilds the state pushed `ticks_back` pushes ago (1 is the most recent)
+   * without modifying the buffer. `inputs` receives the inputs of that tick
+   * and every tick after it, oldest first, so replaying them in order brings
+   * the state back up to date.
+   */
+  bool Peek(int ticks_back, GameState &state, TickInput *inputs) const
+  {
+    if (ticks_back < 1 || ticks_back > tick_count)
+    {
+      return false;
+    }
+
+    Uint64 words[WORD_COUNT];
+    std::memcpy(words, latest_words, sizeof(words));
+    size_t position = head;
+    for (int i = 0; i < ticks_back; i++)
+    {
+      if (i < ticks_back - 1)
+      {
+        position = UndoRecord(position, words, inputs[ticks_back - 1 - i]);
+      }
+      else
+      {
+        ReadInput(position, inputs[0]);
+      }
+    }
+    std::memcpy(&state, words, sizeof(GameState));
+    return true;
+  }
+
+private:
+  std::vector<Uint8> bytes;
+  size_t head = 0;
+  size_t used = 0;
+  int tick_count = 0;
+  Uint64 latest_words[WORD_COUNT] = {};
+
+  static size_t RecordSize(int count)
+  {
+    return 1 + count * sizeof(Uint64) + 1 + sizeof(Uint32);
+  }
+
+  static Uint8 PackInput(TickInput input)
+  {
+    return input.up | (input.left << 1) | (input.right << 2) | (input.toggle_pause << 3);
+  }
+
+  static TickInput UnpackInput(Uint8 packed_input)
+  {
+    TickInput input;
+    input.up = packed_input & 1;
+    input.left = packed_input & (1 << 1);
+    input.right = packed_input & (1 << 2);
+    input.toggle_pause = packed_input & (1 << 3);
+    return input;
+  }
+
+  size_t Wrap(size_t position) const
+  {
+    return position % bytes.size();
+  }
+
+  void CopyIn(size_t position, const void *source, size_t length)
+  {
+    size_t first_length = std::min(length, bytes.size() - position);
+    std::memcpy(bytes.data() + position, source, first_length);
+    std::memcpy(bytes.data(), (const Uint8 *)source + first_length, length - first_length);
+  }
+
+  void CopyOut(size_t position, void *destination, size_t length) const
+  {
+    size_t first_length = std::min(length, bytes.size() - position);
+    std::memcpy(destination, bytes.data() + position, first_length);
+    std::memcpy((Uint8 *)destination + first_length, bytes.data(), length - first_length);
+  }
+
+  void ReadInput(size_t record_end, TickInput &input) const
+  {
+    Uint8 packed_input;
+    CopyOut(Wrap(record_end + bytes.size() - sizeof(Uint32) - 1), &packed_input, 1);
+    input = UnpackInput(packed_input);
+  }
+
+  /**
+   * Applies the record ending at `record_end` in reverse to `words`, and
+   * returns where the record before it ends
+   */
+  size_t UndoRecord(size_t record_end, Uint64 *words, TickInput &input) const
+  {
+    Uint32 mask;
+    CopyOut(Wrap(record_end + bytes.size() - sizeof(Uint32)), &mask, sizeof(mask));
+    ReadInput(record_end, input);
+
+    int count = std::bitset<32>(mask).count();
+    size_t record_start = Wrap(record_end + bytes.size() - RecordSize(count));
+    Uint64 changed_words[WORD_COUNT];
+    CopyOut(Wrap(record_start + 1), changed_words, count * sizeof(Uint64));
+
+    int changed_index = 0;
+    for (int i = 0; i < WORD_COUNT; i++)
+    {
+      if (mask & (1u << i))
+      {
+        words[i] ^= changed_words[changed_index++];
+      }
+    }
+    return record_start;
+  }
+};
+
+#endif
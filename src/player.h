@@ -3,13 +3,23 @@
 
 #include "util.h"
 
+/**
+ * The parts of the player that change while playing; kept trivially copyable
+ * so that it can live inside GameState
+ */
+struct PlayerState
+{
+  util::Rect game_rect = {0.0, -100.0, 46.0, 94.0};
+  double y_velocity = 0.0;
+  SDL_RendererFlip flip = SDL_FLIP_NONE;
+  bool is_grounded = false;
+};
+
 class Player
 {
 public:
-  Player() : rects{game_rect : {0.0, -100.0, 46.0, 94.0}}, max_fall_speed(-15) {}
+  Player() : max_fall_speed(-15) {}
   util::Drawable rects;
-  bool is_grounded;
-  double y_velocity;
   double max_fall_speed;
 };
 
@@ -0,0 +1,154 @@
+#ifndef CASTLE_PLATFORMER_RENDER_SCALE
+#define CASTLE_PLATFORMER_RENDER_SCALE
+
+#include <algorithm>
+#include "util.h"
+
+/**
+ * How the internal render target's resolution is chosen relative to the
+ * letterboxed screen area:
+ * NATIVE: Same size as the screen area
+ * SNAP: Screen area divided by an integer, so the upscale is pixel-perfect
+ * AUTO: Lowered/raised at runtime to keep frame times within budget
+ */
+enum class RenderScaleMode
+{
+  NATIVE,
+  SNAP,
+  AUTO
+};
+
+class RenderScaler
+{
+public:
+  RenderScaler(double frame_budget_ms) : frame_budget_ms(frame_budget_ms) {}
+  RenderScaleMode mode = RenderScaleMode::NATIVE;
+  int snap_divisor = 1;
+
+  // AUTO steps through these, from full resolution downwards
+  static constexpr double AUTO_LEVELS[] = {1.0, 0.85, 0.75, 0.6, 0.5, 0.4};
+  static constexpr int AUTO_LEVEL_COUNT = sizeof(AUTO_LEVELS) / sizeof(AUTO_LEVELS[0]);
+  static constexpr int MAX_SNAP_DIVISOR = 4;
+
+  // Frames averaged before deciding whether to change level
+  static constexpr int SAMPLE_FRAMES = 30;
+  // Frames ignored after a change, while the new target settles
+  static constexpr int SETTLE_FRAMES = 60;
+  // Lower the resolution once the average frame uses this much of the budget...
+  static constexpr double DOWNSCALE_THRESHOLD = 0.9;
+  // ...and only raise it if the next level up is predicted to stay under this
+  static constexpr double UPSCALE_THRESHOLD = 0.65;
+
+  double frame_budget_ms;
+  int auto_level = 0;
+
+  double Scale()
+  {
+    switch (mode)
+    {
+    case RenderScaleMode::SNAP:
+      return 1.0 / snap_divisor;
+    case RenderScaleMode::AUTO:
+      return AUTO_LEVELS[auto_level];
+    default:
+      return 1.0;
+    }
+  }
+
+  /**
+   * Cycles NATIVE -> SNAP 1/2 -> ... -> SNAP 1/MAX_SNAP_DIVISOR -> AUTO -> NATIVE
+   */
+  void NextMode()
+  {
+    if (mode == RenderScaleMode::NATIVE)
+    {
+      mode = RenderScaleMode::SNAP;
+      snap_divisor = 2;
+    }
+    else if (mode == RenderScaleMode::SNAP && snap_divisor < MAX_SNAP_DIVISOR)
+    {
+      snap_divisor++;
+    }
+    else if (mode == RenderScaleMode::SNAP)
+    {
+      mode = RenderScaleMode::AUTO;
+      auto_level = 0;
+    }
+    else
+    {
+      mode = RenderScaleMode::NATIVE;
+    }
+    ResetSamples();
+    settle_frames_left = SETTLE_FRAMES;
+  }
+
+  /**
+   * Records how long the last frame took. In AUTO mode, returns true when
+   * the scale has changed and the render target needs to be recreated.
+   *
+   * Pixel count scales with the square of the scale, so the cost of the next
+   * level up is predicted from the current average; together with the gap
+   * between the two thresholds this keeps the level from oscillating.
+   */
+  bool RecordFrameTime(double frame_ms)
+  {
+    if (mode != RenderScaleMode::AUTO)
+    {
+      return false;
+    }
+    if (settle_frames_left > 0)
+    {
+      settle_frames_left--;
+      return false;
+    }
+
+    sample_total_ms += frame_ms;
+    sample_max_ms = std::max(sample_max_ms, frame_ms);
+    sample_count++;
+    if (sample_count < SAMPLE_FRAMES)
+    {
+      return false;
+    }
+
+    double average_ms = sample_total_ms / sample_count;
+    int new_level = auto_level;
+    if (average_ms > frame_budget_ms * DOWNSCALE_THRESHOLD && auto_level < AUTO_LEVEL_COUNT - 1)
+    {
+      new_level = auto_level + 1;
+    }
+    else if (auto_level > 0)
+    {
+      double pixel_ratio = AUTO_LEVELS[auto_level - 1] / AUTO_LEVELS[auto_level];
+      if (average_ms * pixel_ratio * pixel_ratio < frame_budget_ms * UPSCALE_THRESHOLD)
+      {
+        new_level = auto_level - 1;
+      }
+    }
+
+    bool changed = new_level != auto_level;
+    if (changed)
+    {
+      util::prettyLog("Render scale", AUTO_LEVELS[auto_level], "->", AUTO_LEVELS[new_level],
+                      "| avg frame ms:", average_ms, "max:", sample_max_ms, "budget:", frame_budget_ms);
+      auto_level = new_level;
+      settle_frames_left = SETTLE_FRAMES;
+    }
+    ResetSamples();
+    return changed;
+  }
+
+private:
+  int settle_frames_left = 0;
+  int sample_count = 0;
+  double sample_total_ms = 0.0;
+  double sample_max_ms = 0.0;
+
+  void ResetSamples()
+  {
+    sample_count = 0;
+    sample_total_ms = 0.0;
+    sample_max_ms = 0.0;
+  }
+};
+
+#endif